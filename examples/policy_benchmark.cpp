@@ -0,0 +1,84 @@
+#include <Scheduler.hpp>
+#include <GreenThread.hpp>
+#include <ConditionVariable.hpp>
+#include <Mutex.hpp>
+#include <ThreadingPolicy.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+using namespace GreenThreads;
+
+constexpr int ITERATIONS = 100000;
+
+double yieldCost = 0;
+double lockCost = 0;
+double notifyCost = 0;
+
+template<typename Func>
+double measure(Func func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+}
+
+void yielder() {
+    for (int i = 0; i < ITERATIONS; ++i) {
+        Scheduler::instance().yield();
+    }
+}
+
+void locker() {
+    Mutex mutex;
+    ConditionVariable cv;
+
+    lockCost = measure([&] {
+        for (int i = 0; i < ITERATIONS; ++i) {
+            mutex.lock();
+            mutex.unlock();
+        }
+    });
+
+    notifyCost = measure([&] {
+        for (int i = 0; i < ITERATIONS; ++i) {
+            cv.notify_one();
+        }
+    });
+}
+
+// runOnce() вместо Scheduler::start(): цикл run() делает Sleep(0) после каждого
+// переключения, и системные вызовы заглушают стоимость блокировок политики
+void runUntilFinished(const std::shared_ptr<GreenThread>& first,
+                      const std::shared_ptr<GreenThread>& second = nullptr) {
+    while (!first->isFinished() || (second && !second->isFinished())) {
+        Scheduler::instance().runOnce(0);
+    }
+}
+
+int main() {
+    // Библиотека пишет отладочный вывод на каждой операции. Без буфера поток
+    // сразу в состоянии ошибки и не форматирует его, так что в замер он не входит
+    std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+
+    // Каждый круг runOnce() - по переключению туда и обратно на каждый поток
+    auto first = std::make_shared<GreenThread>(yielder);
+    auto second = std::make_shared<GreenThread>(yielder);
+    first->start();
+    second->start();
+    yieldCost = measure([&] { runUntilFinished(first, second); }) / 2;
+
+    auto lockThread = std::make_shared<GreenThread>(locker);
+    lockThread->start();
+    runUntilFinished(lockThread);
+
+    std::cout.rdbuf(coutBuffer);
+    std::cout.clear();
+
+    std::cout << "Policy: " << ThreadingPolicy::name << std::endl;
+    std::cout << "  yield round trip:     " << yieldCost << " ns" << std::endl;
+    std::cout << "  Mutex lock + unlock:  " << lockCost << " ns" << std::endl;
+    std::cout << "  notify_one (no wait): " << notifyCost << " ns" << std::endl;
+
+    return 0;
+}
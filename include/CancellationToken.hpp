@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace GreenThreads {
+
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("Operation cancelled") {}
+};
+
+// Разделяемый флаг отмены. Токен, созданный с родителем, считается отмененным,
+// если отменен любой из его предков. Пустой токен никогда не отменяется.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    static CancellationToken create(const CancellationToken& parent = CancellationToken()) {
+        CancellationToken token;
+        token.state_ = std::make_shared<State>();
+        token.state_->parent = parent.state_;
+        return token;
+    }
+
+    // Будит внешний цикл планировщика, чтобы ожидающие потоки увидели отмену
+    void cancel();
+
+    bool isCancelled() const {
+        for (const State* state = state_.get(); state; state = state->parent.get()) {
+            if (state->cancelled.load(std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void throwIfCancelled() const {
+        if (isCancelled()) {
+            throw OperationCancelled();
+        }
+    }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::shared_ptr<State> parent;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+} // namespace GreenThreads
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <mutex>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <chrono>
 #include <windows.h>
 #include "GreenThread.hpp"
 #include "Scheduler.hpp"
+#include "ThreadingPolicy.hpp"
+#include "TraceRecorder.hpp"
 
 namespace GreenThreads {
 
@@ -20,6 +22,7 @@ public:
     ConditionVariable(const ConditionVariable&) = delete;
     ConditionVariable& operator=(const ConditionVariable&) = delete;
 
+    // При отмене потока бросает OperationCancelled с уже захваченным lock
     void wait(std::unique_lock<Mutex>& lock);
 
     template<typename Rep, typename Period>
@@ -34,15 +37,19 @@ public:
         }
 
         {
-            std::lock_guard<std::mutex> guard(cvMutex_);
-            waiters_.push(currentThread);
+            std::lock_guard<InternalMutex> guard(cvMutex_);
+            waiters_.push_back(currentThread);
         }
 
+        TraceRecorder::record(TraceRecorder::EventType::BlockCondition, currentThread->getId());
         lock.unlock();
 
-        Scheduler::instance().yield();
+        // До уведомления, отмены или таймаута поток не диспетчеризуется
+        currentThread->yieldWaiting(std::chrono::ceil<std::chrono::steady_clock::duration>(end));
 
-        lock.lock();
+        removeWaiter(currentThread);
+        relock(lock);
+        currentThread->getCancellationToken().throwIfCancelled();
 
         auto now = std::chrono::steady_clock::now();
         return now < end;
@@ -58,8 +65,14 @@ public:
     void notify_all();
 
 private:
-    std::mutex cvMutex_;
-    std::queue<std::shared_ptr<GreenThread>> waiters_;
+    static void traceWake(const GreenThread& waiter);
+    void removeWaiter(const std::shared_ptr<GreenThread>& thread);
+    // Захватывает мьютекс без проверки отмены, чтобы OperationCancelled
+    // всегда вылетал из wait с захваченным lock
+    static void relock(std::unique_lock<Mutex>& lock);
+
+    InternalMutex cvMutex_;
+    std::deque<std::shared_ptr<GreenThread>> waiters_;
 };
 
 } // namespace GreenThreads 
\ No newline at end of file
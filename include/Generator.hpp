@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <windows.h>
+
+namespace GreenThreads {
+
+// Ленивая последовательность: тело выполняется на собственном волокне и
+// отдает элементы через yield_value, каждый шаг - прямое переключение
+// потребитель <-> генератор без участия Scheduler. Тело не должно вызывать
+// Scheduler::yield() и блокироваться на Mutex/ConditionVariable.
+template<typename T>
+class Generator {
+public:
+    class Yielder {
+    public:
+        void yield_value(T value) { generator_.yieldValue(std::move(value)); }
+
+    private:
+        explicit Yielder(Generator& generator) : generator_(generator) {}
+
+        Generator& generator_;
+
+        friend class Generator;
+    };
+
+    using Body = std::function<void(Yielder&)>;
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() = default;
+
+        reference operator*() const { return generator_->value(); }
+        pointer operator->() const { return &generator_->value(); }
+
+        iterator& operator++() {
+            if (!generator_->next()) {
+                generator_ = nullptr;
+            }
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        bool operator==(const iterator& other) const { return generator_ == other.generator_; }
+        bool operator!=(const iterator& other) const { return generator_ != other.generator_; }
+
+    private:
+        explicit iterator(Generator* generator) : generator_(generator) {}
+
+        Generator* generator_ = nullptr;
+
+        friend class Generator;
+    };
+
+    // stackSize - резерв стека волокна, 0 - размер по умолчанию
+    explicit Generator(Body body, size_t stackSize = 0)
+        : body_(std::move(body)), stackSize_(stackSize) {}
+
+    ~Generator() {
+        if (!fiber_) {
+            return;
+        }
+        // Раскручиваем стек приостановленного тела, чтобы вызвать деструкторы
+        if (!finished_) {
+            closing_ = true;
+            try {
+                resumeBody();
+            } catch (...) {
+            }
+        }
+        DeleteFiber(fiber_);
+    }
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    iterator begin() { return next() ? iterator(this) : iterator(); }
+    iterator end() { return iterator(); }
+
+    // Продвигает генератор на один элемент; false - последовательность закончилась
+    bool next() {
+        if (finished_) {
+            return false;
+        }
+
+        if (!fiber_) {
+            fiber_ = stackSize_ ? CreateFiberEx(0, stackSize_, 0, FiberStart, this)
+                                : CreateFiber(0, FiberStart, this);
+            if (!fiber_) {
+                throw std::runtime_error("Failed to create fiber for generator");
+            }
+        }
+
+        value_.reset();
+        resumeBody();
+
+        if (exception_) {
+            std::exception_ptr exception = exception_;
+            exception_ = nullptr;
+            std::rethrow_exception(exception);
+        }
+        return !finished_;
+    }
+
+    T& value() { return *value_; }
+    bool isFinished() const { return finished_; }
+
+private:
+    struct Closing {};
+
+    void resumeBody() {
+        consumerFiber_ = currentFiber();
+        SwitchToFiber(fiber_);
+    }
+
+    void yieldValue(T value) {
+        if (closing_) {
+            throw Closing();
+        }
+        value_.emplace(std::move(value));
+        SwitchToFiber(consumerFiber_);
+        if (closing_) {
+            throw Closing();
+        }
+    }
+
+    static LPVOID currentFiber() {
+        LPVOID fiber = GetCurrentFiber();
+        if (!fiber || fiber == (void*)0x1E00) {
+            fiber = ConvertThreadToFiber(nullptr);
+            if (!fiber) {
+                throw std::runtime_error("Failed to convert thread to fiber for generator");
+            }
+        }
+        return fiber;
+    }
+
+    static void WINAPI FiberStart(LPVOID param) {
+        auto* self = static_cast<Generator*>(param);
+        try {
+            Yielder yielder(*self);
+            self->body_(yielder);
+        } catch (const Closing&) {
+        } catch (...) {
+            self->exception_ = std::current_exception();
+        }
+
+        self->finished_ = true;
+        self->value_.reset();
+        // Волокно не должно возвращаться из стартовой функции
+        SwitchToFiber(self->consumerFiber_);
+    }
+
+    Body body_;
+    size_t stackSize_;
+    LPVOID fiber_ = nullptr;
+    LPVOID consumerFiber_ = nullptr;
+    std::optional<T> value_;
+    std::exception_ptr exception_;
+    bool finished_ = false;
+    bool closing_ = false;
+};
+
+} // namespace GreenThreads
@@ -2,10 +2,18 @@
 
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <atomic>
 #include <windows.h>
 #include <stdexcept>
 #include <chrono>
+#include "CancellationToken.hpp"
+
+#define GREEN_THREADS_STRINGIFY_IMPL(x) #x
+#define GREEN_THREADS_STRINGIFY(x) GREEN_THREADS_STRINGIFY_IMPL(x)
+// Место создания потока в виде строкового литерала "file:line"
+#define GREEN_THREAD_SPAWN_SITE __FILE__ ":" GREEN_THREADS_STRINGIFY(__LINE__)
 
 namespace GreenThreads {
 
@@ -22,20 +30,47 @@ public:
         FINISHED
     };
 
-    explicit GreenThread(ThreadFunction func);
+    // spawnSite должен жить не меньше потока (обычно GREEN_THREAD_SPAWN_SITE
+    // или строковый литерал-тег); по нему группируется StackTelemetry
+    explicit GreenThread(ThreadFunction func, const char* spawnSite = nullptr);
     ~GreenThread();
 
+    using TimePoint = std::chrono::steady_clock::time_point;
+
     void start();
     void resume();
     void yield();
+    // Уступает управление в ожидании условия. Такой поток не взводит событие
+    // готовности планировщика. С дедлайном он не диспетчеризуется раньше него
+    // (TimePoint::max() - до прямого resume()), если его не отменили; без
+    // дедлайна он сам опрашивает условие на каждом круге
+    void yieldWaiting(TimePoint deadline = TimePoint::min());
     void run();
 
     bool isFinished() const;
     int getId() const;
+    const char* getSpawnSite() const { return spawnSite_; }
+
+    // Резерв стека волокна, 0 - по умолчанию или по StackTelemetry. До первого запуска
+    void setStackSize(size_t bytes) { stackSize_ = bytes; }
+    size_t getStackSize() const { return stackSize_; }
+
+    void setCancellationToken(CancellationToken token) { cancellationToken_ = std::move(token); }
+    const CancellationToken& getCancellationToken() const { return cancellationToken_; }
+    bool isCancelled() const { return cancellationToken_.isCancelled(); }
+
+    // Арена с линейным выделением, освобождается целиком при завершении потока
+    std::pmr::memory_resource* arena();
+    void releaseArena();
 
     static void setMainFiber(LPVOID fiber);
     static LPVOID getMainFiber();
     static std::shared_ptr<GreenThread> current();
+    // Арена текущего зеленого потока или ресурс по умолчанию вне его
+    static std::pmr::memory_resource* currentArena();
+
+    bool isWaiting() const { return waiting_; }
+    TimePoint getWakeDeadline() const { return wakeDeadline_; }
 
     State getState() const { return state_; }
     void setState(State state) { state_ = state; }
@@ -44,12 +79,21 @@ public:
 
 private:
     static void WINAPI FiberStart(LPVOID param);
+    bool createFiber();
 
     ThreadFunction function_;
     LPVOID fiber_;
     LPVOID previousFiber_ = nullptr;
     State state_;
     int id_;
+    const char* spawnSite_;
+    size_t stackSize_ = 0;
+    bool waiting_ = false;
+    // Учтен ли поток в Scheduler::waitingQueued_, меняет только планировщик
+    bool queuedWaiting_ = false;
+    TimePoint wakeDeadline_ = TimePoint::min();
+    CancellationToken cancellationToken_;
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
 
     static LPVOID mainFiber_;
     static thread_local std::weak_ptr<GreenThread> currentThread_;
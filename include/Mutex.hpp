@@ -1,10 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <deque>
 #include <memory>
-#include <queue>
 #include <mutex>
+#include "CancellationToken.hpp"
 #include "GreenThread.hpp"
 #include "Scheduler.hpp"
+#include "ThreadingPolicy.hpp"
+#include "TraceRecorder.hpp"
 
 namespace GreenThreads {
 
@@ -16,23 +20,13 @@ public:
     Mutex(const Mutex&) = delete;
     Mutex& operator=(const Mutex&) = delete;
 
+    // Если поток отменен, а мьютекс занят, бросает OperationCancelled
     void lock() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (locked_) {
-            auto current = Scheduler::instance().getCurrentThread();
-            if (current) {
-                waitQueue_.push(current);
-                lock.unlock();
-                current->yield();
-                lock.lock();
-            }
-        }
-        locked_ = true;
-        owner_ = Scheduler::instance().getCurrentThread().get();
+        acquire(true);
     }
 
     bool try_lock() {
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_lock<InternalMutex> lock(mutex_);
         if (!locked_) {
             locked_ = true;
             owner_ = Scheduler::instance().getCurrentThread().get();
@@ -42,7 +36,7 @@ public:
     }
 
     void unlock() {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<InternalMutex> lock(mutex_);
         if (!locked_) {
             throw std::runtime_error("Mutex not locked");
         }
@@ -50,18 +44,52 @@ public:
         owner_ = nullptr;
         if (!waitQueue_.empty()) {
             auto next = waitQueue_.front();
-            waitQueue_.pop();
+            waitQueue_.pop_front();
+            lock.unlock();
+            if (TraceRecorder::isEnabled()) {
+                auto waker = Scheduler::instance().getCurrentThread();
+                TraceRecorder::record(TraceRecorder::EventType::Wake, waker ? waker->getId() : -1, next->getId());
+            }
             next->resume();
         }
     }
 
     friend class std::unique_lock<Mutex>;
     friend class std::lock_guard<Mutex>;
+    friend class ConditionVariable;
 
 private:
+    void acquire(bool cancellable) {
+        std::unique_lock<InternalMutex> lock(mutex_);
+        auto current = Scheduler::instance().getCurrentThread();
+        while (locked_ && current) {
+            if (cancellable && current->isCancelled()) {
+                removeWaiter(current);
+                throw OperationCancelled();
+            }
+            if (std::find(waitQueue_.begin(), waitQueue_.end(), current) == waitQueue_.end()) {
+                waitQueue_.push_back(current);
+            }
+            TraceRecorder::record(TraceRecorder::EventType::BlockMutex, current->getId());
+            lock.unlock();
+            // Будит unlock() через resume(), опрашивать незачем
+            current->yieldWaiting(GreenThread::TimePoint::max());
+            lock.lock();
+        }
+        removeWaiter(current);
+        locked_ = true;
+        owner_ = current.get();
+    }
+
+    void removeWaiter(const std::shared_ptr<GreenThread>& thread) {
+        if (thread) {
+            waitQueue_.erase(std::remove(waitQueue_.begin(), waitQueue_.end(), thread), waitQueue_.end());
+        }
+    }
+
     bool locked_;
-    std::mutex mutex_;
-    std::queue<std::shared_ptr<GreenThread>> waitQueue_;
+    InternalMutex mutex_;
+    std::deque<std::shared_ptr<GreenThread>> waitQueue_;
     GreenThread* owner_;
 };
 
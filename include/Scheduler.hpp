@@ -1,17 +1,59 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <stdexcept>
 #include <windows.h>
+#include "SlabAllocator.hpp"
+#include "ThreadingPolicy.hpp"
 
 namespace GreenThreads {
 
 class GreenThread;
 
+class SpawnRejected : public std::runtime_error {
+public:
+    SpawnRejected() : std::runtime_error("Green thread spawn rejected by admission control") {}
+};
+
+// Что делает GreenThread::start(), когда лимиты планировщика исчерпаны
+enum class SpawnPolicy {
+    Suspend,   // текущий зеленый поток уступает управление, пока не освободится место
+    FailFast,  // бросает SpawnRejected
+    Queue      // откладывает поток в ограниченный список ожидающих запуска
+};
+
+// 0 - без ограничения
+struct AdmissionLimits {
+    size_t maxLiveThreads = 0;
+    size_t maxQueueDepth = 0;     // только готовые потоки, без ожидающих
+    size_t maxPendingSpawns = 0;
+    SpawnPolicy policy = SpawnPolicy::Suspend;
+};
+
+struct AdmissionStats {
+    uint64_t admitted;
+    uint64_t rejected;
+    uint64_t delayed;
+    size_t liveThreads;
+    size_t queueDepth;            // так же, как maxQueueDepth
+    size_t pendingSpawns;
+};
+
 class Scheduler {
 public:
+    // Снимок текущего кванта для StallWatchdog, читается из другого потока
+    struct SliceSample {
+        uint64_t dispatchCount;
+        int threadId;
+        const char* spawnSite;
+    };
+
     static Scheduler& instance();
     
     Scheduler(const Scheduler&) = delete;
@@ -19,26 +61,92 @@ public:
 
     ~Scheduler();
 
+    // Применяет AdmissionLimits; может уступить управление или бросить SpawnRejected
     void addThread(std::shared_ptr<GreenThread> thread);
     void start();
     void stop();
     void run();
     void yield();
+
+    // Пошаговый режим для внешнего цикла событий: выполняет готовые потоки,
+    // пока не исчерпан один из лимитов (0 - без ограничения; оба 0 - один
+    // круг по очереди) или пока в ней не остались только ожидающие, и
+    // возвращает время до следующего события: 0 - есть готовые потоки,
+    // иначе до ближайшего дедлайна ожидающих (опрашивающие условие потоки
+    // перепроверяются раз в миллисекунду), milliseconds::max() - ждать getReadyEvent()
+    std::chrono::milliseconds runOnce(size_t maxDispatches,
+                                      std::chrono::microseconds timeBudget = std::chrono::microseconds(0));
+
+    // Событие с ручным сбросом, взведено, пока в очереди есть готовые потоки.
+    // Потоки в yieldWaiting() его не взводят
+    HANDLE getReadyEvent() const;
+    // Взводит событие готовности из любого потока ОС, например при отмене
+    // CancellationToken, чтобы внешний цикл перепроверил ожидающие потоки
+    void wake();
     
     LPVOID getSchedulerFiber() const;
     std::shared_ptr<GreenThread> getCurrentThread() const;
 
+    void setAdmissionLimits(const AdmissionLimits& limits);
+    AdmissionLimits getAdmissionLimits();
+    AdmissionStats getAdmissionStats();
+
+    SliceSample sampleSlice() const;
+    // Одна попытка без ожидания, для потока, остановленного SuspendThread
+    bool trySampleSlice(SliceSample& sample) const;
+    DWORD getOsThreadId() const;
+
+    // Аллокатор планировщика, использовать только из его системного потока
+    std::pmr::memory_resource* getMemoryResource() { return &slab_; }
+
 private:
     Scheduler();
     
     static void WINAPI SchedulerFiberStart(LPVOID param);
 
+    friend class GreenThread;
+
+    // Квант публикует GreenThread::resume(), в том числе при прямом
+    // пробуждении из unlock()/notify, чтобы StallWatchdog видел настоящий поток
+    void beginSlice(const GreenThread& thread);
+    void endSlice();
+    void publishSlice(int threadId, const char* spawnSite);
+
+    void ensureMainFiber();
+    // false - поток ждет дедлайна и возвращен в очередь без переключения
+    bool dispatch(const std::shared_ptr<GreenThread>& thread);
+    static bool isDue(const GreenThread& thread);
+    void signalReady();
+
+    bool hasCapacity() const;
+    void admitPending();
+    void retireThread(const std::shared_ptr<GreenThread>& thread);
+    size_t runnableDepth() const;
+    void pushReady(std::shared_ptr<GreenThread> thread);
+    std::shared_ptr<GreenThread> popReady();
+
     std::deque<std::shared_ptr<GreenThread>> readyQueue_;
+    // Сколько записей readyQueue_ на момент постановки были ожидающими потоками
+    size_t waitingQueued_ = 0;
     std::set<std::shared_ptr<GreenThread>> runningThreads_;
-    std::mutex queueMutex_;
+    InternalMutex queueMutex_;
     LPVOID schedulerFiber_;
-    std::weak_ptr<GreenThread> currentThread_;
     bool running_;
+    HANDLE readyEvent_ = nullptr;
+    bool readySignalled_ = false;
+    SlabAllocator slab_;
+
+    AdmissionLimits limits_;
+    std::deque<std::shared_ptr<GreenThread>> pendingSpawns_;
+    size_t liveThreads_ = 0;
+    uint64_t admittedSpawns_ = 0;
+    uint64_t rejectedSpawns_ = 0;
+    uint64_t delayedSpawns_ = 0;
+
+    std::atomic<uint64_t> sliceSequence_{0};
+    std::atomic<int> sliceThreadId_{-1};
+    std::atomic<const char*> sliceSpawnSite_{nullptr};
+    std::atomic<DWORD> osThreadId_{0};
 };
 
 } // namespace GreenThreads 
\ No newline at end of file
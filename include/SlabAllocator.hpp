@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace GreenThreads {
+
+// Аллокатор блоков фиксированных размеров (степени двойки от 16 байт до 64 КиБ)
+// для одного системного потока. Освобожденные блоки не возвращаются в upstream,
+// а переиспользуются до уничтожения аллокатора. Не потокобезопасен.
+class SlabAllocator : public std::pmr::memory_resource {
+public:
+    static constexpr size_t MIN_BLOCK_SIZE = 16;
+    static constexpr size_t MAX_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    explicit SlabAllocator(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~SlabAllocator() override;
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    std::pmr::memory_resource* getUpstream() const { return upstream_; }
+    uint64_t getUpstreamAllocations() const { return upstreamAllocations_; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Chunk {
+        void* memory;
+        size_t size;
+    };
+
+    static constexpr size_t CLASS_COUNT = 13;
+
+    static size_t classIndex(size_t bytes);
+    static size_t classSize(size_t index) { return MIN_BLOCK_SIZE << index; }
+
+    void refill(size_t index);
+
+    std::pmr::memory_resource* upstream_;
+    std::array<FreeBlock*, CLASS_COUNT> freeLists_{};
+    std::vector<Chunk> chunks_;
+    uint64_t upstreamAllocations_ = 0;
+};
+
+} // namespace GreenThreads
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace GreenThreads {
+
+// Статистика использования стека зелеными потоками, сгруппированная по месту
+// создания (spawnSite). В адаптивном режиме по ней выбирается размер стека
+// для новых потоков из того же места.
+class StackTelemetry {
+public:
+    struct SiteStats {
+        std::string site;
+        uint64_t samples;
+        size_t maxUsed;
+        size_t totalUsed;
+    };
+
+    static StackTelemetry& instance();
+
+    StackTelemetry(const StackTelemetry&) = delete;
+    StackTelemetry& operator=(const StackTelemetry&) = delete;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void setAdaptive(bool adaptive);
+    void setHeadroom(size_t bytes);
+    void setMinimumStackSize(size_t bytes);
+
+    void record(const char* site, size_t used);
+
+    // 0 - размер по умолчанию (нет данных или адаптивный режим выключен)
+    size_t recommendedStackSize(const char* site) const;
+
+    std::vector<SiteStats> snapshot() const;
+    void reset();
+
+private:
+    StackTelemetry() = default;
+
+    static std::string siteKey(const char* site);
+
+    mutable std::mutex mutex_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<bool> adaptive_{false};
+    size_t headroom_ = 64 * 1024;
+    size_t minimumStackSize_ = 64 * 1024;
+    std::unordered_map<std::string, SiteStats> sites_;
+};
+
+// Замер максимальной глубины стека текущего волокна: arm() заполняет
+// закоммиченную свободную часть стека шаблоном, measure() ищет его границу
+class StackProbe {
+public:
+    void arm();
+    size_t measure() const;
+    bool isArmed() const { return base_ != nullptr; }
+
+private:
+    static constexpr uint64_t POISON = 0xCDCDCDCDCDCDCDCDull;
+    static constexpr size_t CURRENT_FRAME_MARGIN = 4096;
+
+    char* base_ = nullptr;
+    char* initialLimit_ = nullptr;
+    char* poisonEnd_ = nullptr;
+};
+
+} // namespace GreenThreads
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <windows.h>
+
+namespace GreenThreads {
+
+class Scheduler;
+
+// Фоновый поток, который периодически снимает SliceSample с планировщиков
+// и сообщает о зеленых потоках, не отдающих управление дольше порога.
+class StallWatchdog {
+public:
+    struct Report {
+        int threadId;
+        const char* spawnSite;
+        std::chrono::milliseconds sliceDuration;
+        std::vector<void*> backtrace;
+    };
+
+    using ReportHandler = std::function<void(const Report&)>;
+
+    explicit StallWatchdog(std::chrono::milliseconds threshold,
+                           std::chrono::milliseconds sampleInterval = std::chrono::milliseconds(10));
+    ~StallWatchdog();
+
+    StallWatchdog(const StallWatchdog&) = delete;
+    StallWatchdog& operator=(const StallWatchdog&) = delete;
+
+    void watch(Scheduler& scheduler);
+    void setReportHandler(ReportHandler handler);
+    void setCaptureBacktrace(bool enabled);
+
+    void start();
+    void stop();
+
+    static void printReport(const Report& report);
+
+private:
+    struct Watched {
+        Scheduler* scheduler;
+        uint64_t dispatchCount;
+        std::chrono::steady_clock::time_point sliceSeenAt;
+        bool reported;
+    };
+
+    void loop();
+    void check(Watched& watched, std::chrono::steady_clock::time_point now, std::vector<Report>& reports);
+    static bool captureBacktrace(Scheduler& scheduler, uint64_t dispatchCount,
+                                 std::vector<void*>& frames);
+
+    std::chrono::milliseconds threshold_;
+    std::chrono::milliseconds sampleInterval_;
+    std::vector<Watched> watched_;
+    ReportHandler handler_;
+    std::atomic<bool> captureBacktrace_{false};
+
+    std::mutex mutex_;
+    std::condition_variable stopCv_;
+    bool stopRequested_;
+    std::thread thread_;
+};
+
+} // namespace GreenThreads
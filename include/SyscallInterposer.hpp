@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+namespace GreenThreads {
+
+// Подменяет в таблицах импорта блокирующие вызовы Winsock (recv, send,
+// connect, accept, select, WSAPoll) и Sleep. Если вызов сделан из зеленого
+// потока, он превращается в ожидание через yield(). Сокетные вызовы
+// кооперативны только для сокетов, созданных после install() в перехваченных
+// модулях и остающихся блокирующими. Вне зеленых потоков, для неблокирующих
+// сокетов и сокетов неизвестного режима вызовы проходят к оригинальным
+// функциям без изменений.
+// Модули, загруженные после install(), подхватываются повторным вызовом install().
+class SyscallInterposer {
+public:
+    // Все загруженные модули, кроме системных DLL и модуля самой библиотеки.
+    // При статической сборке модуль библиотеки - это exe приложения: чтобы
+    // перехватывать его вызовы, передайте список модулей явно
+    static bool install();
+    // Только перечисленные модули
+    static bool install(const std::vector<HMODULE>& modules);
+    static void uninstall();
+    static bool isInstalled();
+};
+
+} // namespace GreenThreads
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "CancellationToken.hpp"
+#include "GreenThread.hpp"
+
+namespace GreenThreads {
+
+// Группа дочерних зеленых потоков с общим токеном отмены. Деструктор
+// не возвращается, пока все дочерние потоки не завершатся. Вне зеленого
+// потока wait() и деструктор сами крутят планировщик через runOnce().
+class TaskGroup {
+public:
+    // Родительский токен берется у текущего зеленого потока
+    TaskGroup();
+    explicit TaskGroup(const CancellationToken& parent);
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    std::shared_ptr<GreenThread> spawn(GreenThread::ThreadFunction func, const char* spawnSite = nullptr);
+
+    void cancel();
+    void wait();
+
+    bool isCancelled() const { return token_.isCancelled(); }
+    const CancellationToken& getToken() const { return token_; }
+
+private:
+    bool removeFinished();
+    void driveUntilFinished();
+
+    CancellationToken token_;
+    std::vector<std::shared_ptr<GreenThread>> children_;
+};
+
+} // namespace GreenThreads
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+#include "GreenThreadsConfig.hpp"
+
+namespace GreenThreads {
+
+// Пустой мьютекс для сборок, где планировщик и примитивы используются
+// только из одного системного потока
+struct NullMutex {
+    void lock() noexcept {}
+    void unlock() noexcept {}
+    bool try_lock() noexcept { return true; }
+};
+
+struct SingleThreaded {
+    using InternalMutex = NullMutex;
+    static constexpr const char* name = "SingleThreaded";
+};
+
+struct MultiThreaded {
+    using InternalMutex = std::mutex;
+    static constexpr const char* name = "MultiThreaded";
+};
+
+// Политика выбирается при сборке (опция CMake GREEN_THREADS_SINGLE_THREADED)
+// и записывается в сгенерированный GreenThreadsConfig.hpp. От нее зависит
+// раскладка Scheduler, Mutex и ConditionVariable, поэтому MSVC дополнительно
+// проверяет совпадение при компоновке
+#if GREEN_THREADS_SINGLE_THREADED_BUILD
+using ThreadingPolicy = SingleThreaded;
+#if defined(_MSC_VER)
+#pragma detect_mismatch("GreenThreadsPolicy", "SingleThreaded")
+#endif
+#else
+using ThreadingPolicy = MultiThreaded;
+#if defined(_MSC_VER)
+#pragma detect_mismatch("GreenThreadsPolicy", "MultiThreaded")
+#endif
+#endif
+
+using InternalMutex = ThreadingPolicy::InternalMutex;
+
+} // namespace GreenThreads
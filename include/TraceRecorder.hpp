@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace GreenThreads {
+
+// Опциональная запись событий планирования в кольцевые буферы (по одному
+// на системный поток) с последующей выгрузкой в формате Chrome trace-event.
+class TraceRecorder {
+public:
+    enum class EventType : uint8_t {
+        Dispatch,
+        Yield,
+        BlockMutex,
+        BlockCondition,
+        Wake,
+        Spawn,
+        Finish
+    };
+
+    struct Event {
+        uint64_t timestamp;
+        int32_t threadId;
+        int32_t otherId;
+        EventType type;
+    };
+
+    // ringCapacity округляется вверх до степени двойки
+    static void enable(size_t ringCapacity = 1 << 16);
+    static void disable();
+
+    static bool isEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void record(EventType type, int threadId, int otherId = -1) {
+        if (isEnabled()) {
+            append(type, threadId, otherId);
+        }
+    }
+
+    // Забирает накопленные события из всех буферов
+    static void writeChromeTrace(std::ostream& out);
+    static uint64_t droppedEvents();
+
+private:
+    static void append(EventType type, int threadId, int otherId);
+
+    static std::atomic<bool> enabled_;
+};
+
+} // namespace GreenThreads
@@ -0,0 +1,15 @@
+#include "CancellationToken.hpp"
+#include "Scheduler.hpp"
+
+namespace GreenThreads {
+
+void CancellationToken::cancel() {
+    if (state_) {
+        state_->cancelled.store(true, std::memory_order_release);
+        // Потоки, ждущие без дедлайна, иначе не будут диспетчеризованы,
+        // а runOnce() мог вернуть milliseconds::max()
+        Scheduler::instance().wake();
+    }
+}
+
+} // namespace GreenThreads
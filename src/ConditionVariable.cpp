@@ -2,6 +2,7 @@
 #include "Mutex.hpp"
 #include "GreenThread.hpp"
 #include "Scheduler.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
@@ -16,54 +17,80 @@ void ConditionVariable::wait(std::unique_lock<Mutex>& lock) {
 
     {
         std::cout << "ConditionVariable::wait - Adding to waiters" << std::endl;
-        std::lock_guard<std::mutex> guard(cvMutex_);
-        waiters_.push(currentThread);
+        std::lock_guard<InternalMutex> guard(cvMutex_);
+        waiters_.push_back(currentThread);
     }
 
+    TraceRecorder::record(TraceRecorder::EventType::BlockCondition, currentThread->getId());
+
     std::cout << "ConditionVariable::wait - Unlocking mutex" << std::endl;
     lock.unlock();
 
     std::cout << "ConditionVariable::wait - Yielding" << std::endl;
-    Scheduler::instance().yield();
+    // До notify или отмены поток не диспетчеризуется
+    currentThread->yieldWaiting(GreenThread::TimePoint::max());
+
+    removeWaiter(currentThread);
 
     std::cout << "ConditionVariable::wait - Reacquiring lock" << std::endl;
-    lock.lock();
+    relock(lock);
+    currentThread->getCancellationToken().throwIfCancelled();
     std::cout << "ConditionVariable::wait - Completed" << std::endl;
 }
 
+void ConditionVariable::relock(std::unique_lock<Mutex>& lock) {
+    Mutex* mutex = lock.release();
+    mutex->acquire(false);
+    lock = std::unique_lock<Mutex>(*mutex, std::adopt_lock);
+}
+
+void ConditionVariable::removeWaiter(const std::shared_ptr<GreenThread>& thread) {
+    std::lock_guard<InternalMutex> guard(cvMutex_);
+    waiters_.erase(std::remove(waiters_.begin(), waiters_.end(), thread), waiters_.end());
+}
+
+void ConditionVariable::traceWake(const GreenThread& waiter) {
+    if (TraceRecorder::isEnabled()) {
+        auto waker = Scheduler::instance().getCurrentThread();
+        TraceRecorder::record(TraceRecorder::EventType::Wake, waker ? waker->getId() : -1, waiter.getId());
+    }
+}
+
 void ConditionVariable::notify_one() {
     std::shared_ptr<GreenThread> waiter;
     
     {
-        std::lock_guard<std::mutex> guard(cvMutex_);
+        std::lock_guard<InternalMutex> guard(cvMutex_);
         if (waiters_.empty()) {
             return;
         }
         
         waiter = waiters_.front();
-        waiters_.pop();
+        waiters_.pop_front();
     }
     
     if (waiter && !waiter->isFinished()) {
         std::cout << "ConditionVariable::notify_one - Resuming waiter" << std::endl;
+        traceWake(*waiter);
         waiter->resume();
     }
 }
 
 void ConditionVariable::notify_all() {
-    std::queue<std::shared_ptr<GreenThread>> waitersToResume;
+    std::deque<std::shared_ptr<GreenThread>> waitersToResume;
     
     {
-        std::lock_guard<std::mutex> guard(cvMutex_);
+        std::lock_guard<InternalMutex> guard(cvMutex_);
         std::swap(waiters_, waitersToResume);
     }
     
     while (!waitersToResume.empty()) {
         auto waiter = waitersToResume.front();
-        waitersToResume.pop();
+        waitersToResume.pop_front();
         
         if (waiter && !waiter->isFinished()) {
             std::cout << "ConditionVariable::notify_all - Resuming waiter" << std::endl;
+            traceWake(*waiter);
             waiter->resume();
         }
     }
@@ -1,5 +1,7 @@
 #include "GreenThread.hpp"
 #include "Scheduler.hpp"
+#include "StackTelemetry.hpp"
+#include "TraceRecorder.hpp"
 #include <iostream>
 #include <stdexcept>
 
@@ -8,15 +10,18 @@ namespace GreenThreads {
 LPVOID GreenThread::mainFiber_ = nullptr;
 thread_local std::weak_ptr<GreenThread> GreenThread::currentThread_;
 static std::atomic<int> nextId = 0;
+static constexpr size_t ARENA_INITIAL_SIZE = 1024;
 
-GreenThread::GreenThread(ThreadFunction func)
+GreenThread::GreenThread(ThreadFunction func, const char* spawnSite)
     : function_(std::move(func)), 
       fiber_(nullptr),
       state_(State::READY),
-      id_(nextId++) {
+      id_(nextId++),
+      spawnSite_(spawnSite) {
 }
 
 GreenThread::~GreenThread() {
+    releaseArena();
     if (fiber_ && GetCurrentFiber() != fiber_) {
         DeleteFiber(fiber_);
         fiber_ = nullptr;
@@ -28,15 +33,27 @@ void GreenThread::start() {
         return;
     }
 
-    if (!fiber_) {
-        fiber_ = CreateFiber(0, FiberStart, this);
-        if (!fiber_) {
-            throw std::runtime_error("Failed to create fiber for green thread");
-        }
-    }
-
     std::cout << "Starting thread " << id_ << std::endl;
     Scheduler::instance().addThread(shared_from_this());
+    if (TraceRecorder::isEnabled()) {
+        auto parent = currentThread_.lock();
+        TraceRecorder::record(TraceRecorder::EventType::Spawn, id_, parent ? parent->getId() : -1);
+    }
+}
+
+bool GreenThread::createFiber() {
+    size_t stackSize = stackSize_;
+    if (!stackSize) {
+        stackSize = StackTelemetry::instance().recommendedStackSize(spawnSite_);
+    }
+    fiber_ = stackSize ? CreateFiberEx(0, stackSize, 0, FiberStart, this)
+                       : CreateFiber(0, FiberStart, this);
+    if (!fiber_) {
+        std::cerr << "ERROR: Failed to create fiber for thread " << id_
+                  << ", error: " << GetLastError() << std::endl;
+        return false;
+    }
+    return true;
 }
 
 void GreenThread::resume() {
@@ -46,9 +63,14 @@ void GreenThread::resume() {
             return;
         }
 
-        if (!fiber_) {
-            std::cerr << "ERROR: Cannot resume thread " << id_ << " with no fiber" << std::endl;
-            throw std::runtime_error("Cannot resume thread with no fiber");
+        // Стек выделяется при первом запуске, а не при start(): потоки,
+        // отложенные контролем допуска, не держат зарезервированную память
+        // Нехватка памяти под стек не должна валить планировщик: поток
+        // завершается без запуска, а планировщик освобождает его место
+        if (!fiber_ && !createFiber()) {
+            state_ = State::FINISHED;
+            TraceRecorder::record(TraceRecorder::EventType::Finish, id_);
+            return;
         }
 
         LPVOID currentFiber = GetCurrentFiber();
@@ -60,12 +82,26 @@ void GreenThread::resume() {
         std::cout << "Thread " << id_ << " being resumed, current fiber: " << currentFiber << ", target fiber: " << fiber_ << std::endl;
         
         previousFiber_ = currentFiber;
+        // Поток, будящий другой напрямую, снова станет текущим после возврата
+        auto resumer = currentThread_;
         currentThread_ = shared_from_this();
         state_ = State::RUNNING;
+        // Кто бы ни разбудил поток, ожидание закончено; новое начнется со следующего yieldWaiting()
+        waiting_ = false;
+        wakeDeadline_ = TimePoint::min();
         
         std::cout << "Switching to thread " << id_ << "'s fiber" << std::endl;
         
+        Scheduler& scheduler = Scheduler::instance();
+        scheduler.beginSlice(*this);
+        TraceRecorder::record(TraceRecorder::EventType::Dispatch, id_);
         SwitchToFiber(fiber_);
+        currentThread_ = resumer;
+        if (auto resumerThread = resumer.lock()) {
+            scheduler.beginSlice(*resumerThread);
+        } else {
+            scheduler.endSlice();
+        }
         
         std::cout << "Returned to thread " << id_ << " from fiber, state: " << 
             (state_ == State::FINISHED ? "FINISHED" : 
@@ -81,6 +117,12 @@ void GreenThread::resume() {
     }
 }
 
+void GreenThread::yieldWaiting(TimePoint deadline) {
+    waiting_ = true;
+    wakeDeadline_ = deadline;
+    yield();
+}
+
 void GreenThread::yield() {
     std::cout << "Thread " << id_ << " yielding" << std::endl;
     
@@ -101,6 +143,7 @@ void GreenThread::yield() {
     currentThread_.reset();
     LPVOID fiberToSwitchTo = previousFiber_;
     previousFiber_ = nullptr;
+    TraceRecorder::record(TraceRecorder::EventType::Yield, id_);
     SwitchToFiber(fiberToSwitchTo);
 }
 
@@ -123,16 +166,29 @@ void WINAPI GreenThread::FiberStart(LPVOID param) {
 
         std::cout << "Starting fiber for thread " << thread->getId() << std::endl;
         
+        StackProbe stackProbe;
+        if (StackTelemetry::instance().isEnabled()) {
+            stackProbe.arm();
+        }
+
         try {
             std::cout << "FiberStart: About to run thread function for thread " << thread->getId() << std::endl;
             thread->run();
             std::cout << "FiberStart: Thread function completed normally for thread " << thread->getId() << std::endl;
+        } catch (const OperationCancelled&) {
+            std::cout << "Thread " << thread->getId() << " cancelled" << std::endl;
         } catch (const std::exception& e) {
             std::cerr << "Exception in thread " << thread->getId() << ": " << e.what() << std::endl;
         } catch (...) {
             std::cerr << "Unknown exception in thread " << thread->getId() << std::endl;
         }
 
+        thread->releaseArena();
+
+        if (stackProbe.isArmed()) {
+            StackTelemetry::instance().record(thread->spawnSite_, stackProbe.measure());
+        }
+
         std::cout << "Thread " << thread->getId() << " function completed, marking as FINISHED" << std::endl;
         thread->state_ = State::FINISHED;
 
@@ -155,6 +211,7 @@ void WINAPI GreenThread::FiberStart(LPVOID param) {
         std::cout << "FiberStart: Thread " << thread->getId() << " clearing current thread reference" << std::endl;
         
         thread->currentThread_.reset();
+        TraceRecorder::record(TraceRecorder::EventType::Finish, thread->getId());
         
         std::cout << "Thread " << thread->getId() << " switching back to fiber: " << fiberToSwitchTo << std::endl;
         
@@ -179,11 +236,28 @@ void WINAPI GreenThread::FiberStart(LPVOID param) {
 }
 
 void GreenThread::run() {
+    cancellationToken_.throwIfCancelled();
     if (function_) {
         function_();
     }
 }
 
+std::pmr::memory_resource* GreenThread::arena() {
+    if (!arena_) {
+        arena_.emplace(ARENA_INITIAL_SIZE, Scheduler::instance().getMemoryResource());
+    }
+    return &*arena_;
+}
+
+void GreenThread::releaseArena() {
+    arena_.reset();
+}
+
+std::pmr::memory_resource* GreenThread::currentArena() {
+    auto thread = currentThread_.lock();
+    return thread ? thread->arena() : std::pmr::get_default_resource();
+}
+
 int GreenThread::getId() const {
     return id_;
 }
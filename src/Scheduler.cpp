@@ -6,38 +6,200 @@
 
 namespace GreenThreads {
 
+// Как часто внешний цикл перепроверяет потоки, ожидающие условия опросом
+static constexpr std::chrono::milliseconds POLL_INTERVAL(1);
+
 Scheduler& Scheduler::instance() {
     static Scheduler instance;
     return instance;
 }
 
-Scheduler::Scheduler() : schedulerFiber_(nullptr), running_(false) {}
+Scheduler::Scheduler() : schedulerFiber_(nullptr), running_(false) {
+    readyEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!readyEvent_) {
+        throw std::runtime_error("Failed to create scheduler ready event");
+    }
+}
 
 Scheduler::~Scheduler() {
     stop();
+    if (readyEvent_) {
+        CloseHandle(readyEvent_);
+        readyEvent_ = nullptr;
+    }
     if (schedulerFiber_) {
         DeleteFiber(schedulerFiber_);
         schedulerFiber_ = nullptr;
     }
 }
 
+// Поток, чье волокно выполняется сейчас; при прямом resume() из notify/unlock
+// это разбуженный поток, а не тот, что диспетчеризовал планировщик
 std::shared_ptr<GreenThread> Scheduler::getCurrentThread() const {
-    return currentThread_.lock();
+    return GreenThread::current();
+}
+
+Scheduler::SliceSample Scheduler::sampleSlice() const {
+    SliceSample sample{};
+    while (!trySampleSlice(sample)) {
+        YieldProcessor();
+    }
+    return sample;
+}
+
+bool Scheduler::trySampleSlice(SliceSample& sample) const {
+    // Нечетная последовательность - запись еще идет
+    uint64_t before = sliceSequence_.load(std::memory_order_acquire);
+    if (before & 1) {
+        return false;
+    }
+    sample.threadId = sliceThreadId_.load(std::memory_order_relaxed);
+    sample.spawnSite = sliceSpawnSite_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (before != sliceSequence_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    sample.dispatchCount = before / 2;
+    return true;
+}
+
+DWORD Scheduler::getOsThreadId() const {
+    return osThreadId_.load(std::memory_order_relaxed);
+}
+
+void Scheduler::beginSlice(const GreenThread& thread) {
+    publishSlice(thread.getId(), thread.getSpawnSite());
+}
+
+void Scheduler::endSlice() {
+    publishSlice(-1, nullptr);
+}
+
+void Scheduler::publishSlice(int threadId, const char* spawnSite) {
+    // Пишет только поток планировщика, поэтому без RMW
+    uint64_t sequence = sliceSequence_.load(std::memory_order_relaxed);
+    sliceSequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    sliceSpawnSite_.store(spawnSite, std::memory_order_relaxed);
+    sliceThreadId_.store(threadId, std::memory_order_relaxed);
+    sliceSequence_.store(sequence + 2, std::memory_order_release);
 }
 
 void Scheduler::addThread(std::shared_ptr<GreenThread> thread) {
     if (!thread) return;
     
-    std::lock_guard<std::mutex> lock(queueMutex_);
+    std::unique_lock<InternalMutex> lock(queueMutex_);
+    bool delayed = false;
+    while (!hasCapacity()) {
+        // Ждать может только зеленый поток этого потока ОС; чужие потоки ОС
+        // уходят в список ожидающих
+        auto current = GreenThread::current();
+        bool canSuspend = limits_.policy == SpawnPolicy::Suspend && current && current != thread;
+
+        if (limits_.policy == SpawnPolicy::FailFast) {
+            rejectedSpawns_++;
+            throw SpawnRejected();
+        }
+
+        if (!canSuspend) {
+            // Вне зеленого потока ждать некому - откладываем в список ожидающих
+            if (limits_.maxPendingSpawns && pendingSpawns_.size() >= limits_.maxPendingSpawns) {
+                rejectedSpawns_++;
+                throw SpawnRejected();
+            }
+            pendingSpawns_.push_back(std::move(thread));
+            delayedSpawns_++;
+            return;
+        }
+
+        if (!delayed) {
+            delayed = true;
+            delayedSpawns_++;
+        }
+        if (current->isCancelled()) {
+            throw OperationCancelled();
+        }
+
+        lock.unlock();
+        current->yieldWaiting();
+        lock.lock();
+    }
+
+    liveThreads_++;
+    admittedSpawns_++;
+    pushReady(std::move(thread));
+    // Новый поток готов, даже если в очереди одни ожидающие
+    signalReady();
+}
+
+void Scheduler::setAdmissionLimits(const AdmissionLimits& limits) {
+    std::lock_guard<InternalMutex> lock(queueMutex_);
+    limits_ = limits;
+    admitPending();
+}
+
+AdmissionLimits Scheduler::getAdmissionLimits() {
+    std::lock_guard<InternalMutex> lock(queueMutex_);
+    return limits_;
+}
+
+AdmissionStats Scheduler::getAdmissionStats() {
+    std::lock_guard<InternalMutex> lock(queueMutex_);
+    return {admittedSpawns_, rejectedSpawns_, delayedSpawns_,
+            liveThreads_, runnableDepth(), pendingSpawns_.size()};
+}
+
+bool Scheduler::hasCapacity() const {
+    return (!limits_.maxLiveThreads || liveThreads_ < limits_.maxLiveThreads) &&
+           (!limits_.maxQueueDepth || runnableDepth() < limits_.maxQueueDepth);
+}
+
+// Ожидающие в Mutex, ConditionVariable и Sleep тоже лежат в очереди, но
+// очередью на выполнение не являются и не должны блокировать запуск новых
+size_t Scheduler::runnableDepth() const {
+    return readyQueue_.size() - waitingQueued_;
+}
+
+void Scheduler::pushReady(std::shared_ptr<GreenThread> thread) {
+    thread->queuedWaiting_ = thread->isWaiting();
+    if (thread->queuedWaiting_) {
+        waitingQueued_++;
+    }
     readyQueue_.push_back(std::move(thread));
 }
 
-void Scheduler::start() {
-    if (running_) return;
-    
-    std::cout << "Scheduler::start() called" << std::endl;
-    running_ = true;
-    
+std::shared_ptr<GreenThread> Scheduler::popReady() {
+    auto thread = std::move(readyQueue_.front());
+    readyQueue_.pop_front();
+    if (thread->queuedWaiting_) {
+        thread->queuedWaiting_ = false;
+        waitingQueued_--;
+    }
+    return thread;
+}
+
+void Scheduler::admitPending() {
+    bool admitted = false;
+    while (!pendingSpawns_.empty() && hasCapacity()) {
+        pushReady(std::move(pendingSpawns_.front()));
+        pendingSpawns_.pop_front();
+        liveThreads_++;
+        admittedSpawns_++;
+        admitted = true;
+    }
+    if (admitted) {
+        signalReady();
+    }
+}
+
+void Scheduler::retireThread(const std::shared_ptr<GreenThread>& thread) {
+    if (runningThreads_.erase(thread)) {
+        liveThreads_--;
+        admitPending();
+    }
+}
+
+void Scheduler::ensureMainFiber() {
     if (!GreenThread::getMainFiber()) {
         std::cout << "Converting main thread to fiber" << std::endl;
         LPVOID mainFiber = ConvertThreadToFiber(nullptr);
@@ -54,6 +216,15 @@ void Scheduler::start() {
         std::cout << "Setting main fiber: " << mainFiber << std::endl;
         GreenThread::setMainFiber(mainFiber);
     }
+}
+
+void Scheduler::start() {
+    if (running_) return;
+    
+    std::cout << "Scheduler::start() called" << std::endl;
+    running_ = true;
+    
+    ensureMainFiber();
     
     if (!schedulerFiber_) {
         std::cout << "Creating scheduler fiber" << std::endl;
@@ -83,13 +254,16 @@ void Scheduler::run() {
             std::cout << "Current fiber as scheduler: " << schedulerFiber_ << std::endl;
         }
         
+        osThreadId_.store(GetCurrentThreadId(), std::memory_order_relaxed);
+
         std::cout << "Entering scheduler loop" << std::endl;
         while (running_) {
             std::shared_ptr<GreenThread> thread = nullptr;
             bool needSleep = false;
             
             try {
-                std::lock_guard<std::mutex> lock(queueMutex_);
+                std::lock_guard<InternalMutex> lock(queueMutex_);
+                admitPending();
                 std::cout << "Queue size: " << readyQueue_.size() << ", Running threads: " << runningThreads_.size() << std::endl;
                 
                 if (readyQueue_.empty()) {
@@ -100,8 +274,7 @@ void Scheduler::run() {
                     needSleep = true;
                     std::cout << "No ready threads, waiting..." << std::endl;
                 } else {
-                    thread = readyQueue_.front();
-                    readyQueue_.pop_front();
+                    thread = popReady();
                     runningThreads_.insert(thread);
                     std::cout << "Got thread ID " << thread->getId() << " from queue" << std::endl;
                 }
@@ -116,33 +289,7 @@ void Scheduler::run() {
             }
             
             if (thread) {
-                try {
-                    if (!thread->isFinished()) {
-                        std::cout << "About to resume thread " << thread->getId() << std::endl;
-                        currentThread_ = thread;
-                        thread->resume();
-                        std::cout << "Thread " << thread->getId() << " resumed and returned" << std::endl;
-                        
-                        if (thread->isFinished()) {
-                            std::lock_guard<std::mutex> lock(queueMutex_);
-                            runningThreads_.erase(thread);
-                            std::cout << "Thread " << thread->getId() << " finished and removed from scheduler" << std::endl;
-                        } else if (thread->getState() == GreenThread::State::READY) {
-                            std::lock_guard<std::mutex> lock(queueMutex_);
-                            readyQueue_.push_back(thread);
-                            std::cout << "Thread " << thread->getId() << " yielded, putting back in queue" << std::endl;
-                        } else {
-                            std::cout << "Thread " << thread->getId() << " in state: " << static_cast<int>(thread->getState()) << std::endl;
-                        }
-                    } else {
-                        std::lock_guard<std::mutex> lock(queueMutex_);
-                        runningThreads_.erase(thread);
-                        std::cout << "Thread " << thread->getId() << " was already finished, removing" << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "ERROR in thread execution: " << e.what() << std::endl;
-                    throw;
-                }
+                dispatch(thread);
             }
             
             Sleep(0);
@@ -175,6 +322,153 @@ void Scheduler::run() {
     }
 }
 
+std::chrono::milliseconds Scheduler::runOnce(size_t maxDispatches, std::chrono::microseconds timeBudget) {
+    if (running_) {
+        throw std::runtime_error("runOnce() called while the scheduler loop is running");
+    }
+    if (GreenThread::current()) {
+        throw std::runtime_error("runOnce() called from inside a green thread");
+    }
+
+    ensureMainFiber();
+    osThreadId_.store(GetCurrentThreadId(), std::memory_order_relaxed);
+
+    auto deadline = std::chrono::steady_clock::now() + timeBudget;
+    size_t dispatched = 0;
+    size_t idle = 0;
+
+    {
+        // Без лимитов - один круг по потокам, готовым на момент вызова
+        std::lock_guard<InternalMutex> lock(queueMutex_);
+        admitPending();
+        if (!maxDispatches && timeBudget.count() <= 0) {
+            maxDispatches = readyQueue_.size();
+        }
+    }
+
+    while (!maxDispatches || dispatched < maxDispatches) {
+        if (timeBudget.count() > 0 && dispatched && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+
+        std::shared_ptr<GreenThread> thread;
+        {
+            std::lock_guard<InternalMutex> lock(queueMutex_);
+            admitPending();
+            // Полный круг без продвижения - в очереди только ожидающие
+            if (readyQueue_.empty() || idle >= readyQueue_.size()) {
+                break;
+            }
+            thread = popReady();
+            runningThreads_.insert(thread);
+        }
+
+        bool resumed = dispatch(thread);
+        dispatched++;
+        idle = resumed && !thread->isWaiting() ? 0 : idle + 1;
+    }
+
+    std::lock_guard<InternalMutex> lock(queueMutex_);
+    admitPending();
+
+    auto now = std::chrono::steady_clock::now();
+    auto wakeAt = GreenThread::TimePoint::max();
+    for (const auto& thread : readyQueue_) {
+        if (!thread->isWaiting() || thread->isCancelled()) {
+            signalReady();
+            return std::chrono::milliseconds(0);
+        }
+
+        auto wakeDeadline = thread->getWakeDeadline();
+        if (wakeDeadline == GreenThread::TimePoint::min()) {
+            wakeAt = std::min(wakeAt, now + POLL_INTERVAL);
+        } else if (wakeDeadline <= now) {
+            signalReady();
+            return std::chrono::milliseconds(0);
+        } else {
+            wakeAt = std::min(wakeAt, wakeDeadline);
+        }
+    }
+
+    readySignalled_ = false;
+    ResetEvent(readyEvent_);
+    // Отмена из другого потока ОС между проверкой и сбросом события взводит
+    // его через wake() до сброса, поэтому перепроверяем токены после него
+    for (const auto& thread : readyQueue_) {
+        if (thread->isCancelled()) {
+            signalReady();
+            return std::chrono::milliseconds(0);
+        }
+    }
+
+    if (wakeAt == GreenThread::TimePoint::max()) {
+        return std::chrono::milliseconds::max();
+    }
+    // Вверх, чтобы внешний цикл не проснулся раньше дедлайна и не крутился впустую
+    return std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now);
+}
+
+HANDLE Scheduler::getReadyEvent() const {
+    return readyEvent_;
+}
+
+void Scheduler::wake() {
+    if (readyEvent_) {
+        SetEvent(readyEvent_);
+    }
+}
+
+void Scheduler::signalReady() {
+    if (readyEvent_ && !readySignalled_) {
+        readySignalled_ = true;
+        SetEvent(readyEvent_);
+    }
+}
+
+bool Scheduler::isDue(const GreenThread& thread) {
+    if (!thread.isWaiting() || thread.getWakeDeadline() == GreenThread::TimePoint::min()) {
+        return true;
+    }
+    // Отмененный поток будим сразу, чтобы он успел бросить OperationCancelled
+    return thread.isCancelled() || std::chrono::steady_clock::now() >= thread.getWakeDeadline();
+}
+
+bool Scheduler::dispatch(const std::shared_ptr<GreenThread>& thread) {
+    try {
+        if (!thread->isFinished() && !isDue(*thread)) {
+            std::lock_guard<InternalMutex> lock(queueMutex_);
+            pushReady(thread);
+            return false;
+        }
+
+        if (!thread->isFinished()) {
+            std::cout << "About to resume thread " << thread->getId() << std::endl;
+            thread->resume();
+            std::cout << "Thread " << thread->getId() << " resumed and returned" << std::endl;
+            
+            if (thread->isFinished()) {
+                std::lock_guard<InternalMutex> lock(queueMutex_);
+                retireThread(thread);
+                std::cout << "Thread " << thread->getId() << " finished and removed from scheduler" << std::endl;
+            } else if (thread->getState() == GreenThread::State::READY) {
+                std::lock_guard<InternalMutex> lock(queueMutex_);
+                pushReady(thread);
+                std::cout << "Thread " << thread->getId() << " yielded, putting back in queue" << std::endl;
+            } else {
+                std::cout << "Thread " << thread->getId() << " in state: " << static_cast<int>(thread->getState()) << std::endl;
+            }
+        } else {
+            std::lock_guard<InternalMutex> lock(queueMutex_);
+            retireThread(thread);
+            std::cout << "Thread " << thread->getId() << " was already finished, removing" << std::endl;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR in thread execution: " << e.what() << std::endl;
+        throw;
+    }
+}
+
 void WINAPI Scheduler::SchedulerFiberStart(LPVOID param) {
     Scheduler* scheduler = static_cast<Scheduler*>(param);
     if (scheduler) {
@@ -191,7 +485,7 @@ LPVOID Scheduler::getSchedulerFiber() const {
 }
 
 void Scheduler::yield() {
-    auto thread = currentThread_.lock();
+    auto thread = GreenThread::current();
     if (thread) {
         thread->yield();
     } else if (schedulerFiber_) {
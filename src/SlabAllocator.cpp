@@ -0,0 +1,77 @@
+#include "SlabAllocator.hpp"
+
+namespace GreenThreads {
+
+static_assert(SlabAllocator::MIN_BLOCK_SIZE << 12 == SlabAllocator::MAX_BLOCK_SIZE,
+              "CLASS_COUNT must cover MIN_BLOCK_SIZE..MAX_BLOCK_SIZE");
+
+SlabAllocator::SlabAllocator(std::pmr::memory_resource* upstream)
+    : upstream_(upstream ? upstream : std::pmr::new_delete_resource()) {}
+
+SlabAllocator::~SlabAllocator() {
+    for (const auto& chunk : chunks_) {
+        upstream_->deallocate(chunk.memory, chunk.size, alignof(std::max_align_t));
+    }
+}
+
+size_t SlabAllocator::classIndex(size_t bytes) {
+    size_t index = 0;
+    while (classSize(index) < bytes) {
+        ++index;
+    }
+    return index;
+}
+
+void SlabAllocator::refill(size_t index) {
+    size_t blockSize = classSize(index);
+    size_t chunkSize = blockSize < CHUNK_SIZE ? CHUNK_SIZE : blockSize;
+
+    char* memory = static_cast<char*>(upstream_->allocate(chunkSize, alignof(std::max_align_t)));
+    ++upstreamAllocations_;
+    try {
+        chunks_.push_back({memory, chunkSize});
+    } catch (...) {
+        upstream_->deallocate(memory, chunkSize, alignof(std::max_align_t));
+        throw;
+    }
+
+    for (size_t offset = chunkSize; offset >= blockSize; offset -= blockSize) {
+        auto* block = reinterpret_cast<FreeBlock*>(memory + offset - blockSize);
+        block->next = freeLists_[index];
+        freeLists_[index] = block;
+    }
+}
+
+void* SlabAllocator::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes > MAX_BLOCK_SIZE || alignment > alignof(std::max_align_t)) {
+        ++upstreamAllocations_;
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    size_t index = classIndex(bytes);
+    if (!freeLists_[index]) {
+        refill(index);
+    }
+
+    FreeBlock* block = freeLists_[index];
+    freeLists_[index] = block->next;
+    return block;
+}
+
+void SlabAllocator::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    if (bytes > MAX_BLOCK_SIZE || alignment > alignof(std::max_align_t)) {
+        upstream_->deallocate(p, bytes, alignment);
+        return;
+    }
+
+    size_t index = classIndex(bytes);
+    auto* block = static_cast<FreeBlock*>(p);
+    block->next = freeLists_[index];
+    freeLists_[index] = block;
+}
+
+bool SlabAllocator::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+} // namespace GreenThreads
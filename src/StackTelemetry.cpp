@@ -0,0 +1,122 @@
+#include "StackTelemetry.hpp"
+#include <algorithm>
+#include <windows.h>
+
+namespace GreenThreads {
+
+static constexpr size_t STACK_GRANULARITY = 64 * 1024;
+
+StackTelemetry& StackTelemetry::instance() {
+    static StackTelemetry instance;
+    return instance;
+}
+
+void StackTelemetry::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+// Вызывается на каждом запуске потока, поэтому без блокировки
+bool StackTelemetry::isEnabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+void StackTelemetry::setAdaptive(bool adaptive) {
+    adaptive_.store(adaptive, std::memory_order_relaxed);
+}
+
+void StackTelemetry::setHeadroom(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    headroom_ = bytes;
+}
+
+void StackTelemetry::setMinimumStackSize(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    minimumStackSize_ = bytes;
+}
+
+std::string StackTelemetry::siteKey(const char* site) {
+    return site ? site : "unknown";
+}
+
+void StackTelemetry::record(const char* site, size_t used) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = siteKey(site);
+    auto it = sites_.find(key);
+    if (it == sites_.end()) {
+        it = sites_.emplace(key, SiteStats{key, 0, 0, 0}).first;
+    }
+    SiteStats& stats = it->second;
+    stats.samples++;
+    stats.maxUsed = std::max(stats.maxUsed, used);
+    stats.totalUsed += used;
+}
+
+size_t StackTelemetry::recommendedStackSize(const char* site) const {
+    if (!adaptive_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sites_.find(siteKey(site));
+    if (it == sites_.end()) {
+        return 0;
+    }
+
+    // Переполнение все равно упрется в guard-страницу, а не испортит память
+    size_t size = std::max(it->second.maxUsed + headroom_, minimumStackSize_);
+    return (size + STACK_GRANULARITY - 1) / STACK_GRANULARITY * STACK_GRANULARITY;
+}
+
+std::vector<StackTelemetry::SiteStats> StackTelemetry::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SiteStats> result;
+    result.reserve(sites_.size());
+    for (const auto& entry : sites_) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+void StackTelemetry::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sites_.clear();
+}
+
+void StackProbe::arm() {
+    auto* tib = reinterpret_cast<NT_TIB*>(NtCurrentTeb());
+    base_ = static_cast<char*>(tib->StackBase);
+    initialLimit_ = static_cast<char*>(tib->StackLimit);
+
+    // Не трогаем кадр этой функции и то, что выше нее
+    volatile char marker = 0;
+    char* end = const_cast<char*>(&marker) - CURRENT_FRAME_MARGIN;
+    end -= reinterpret_cast<uintptr_t>(end) % sizeof(uint64_t);
+    poisonEnd_ = end > initialLimit_ ? end : initialLimit_;
+
+    for (auto* word = reinterpret_cast<volatile uint64_t*>(initialLimit_);
+         reinterpret_cast<char*>(const_cast<uint64_t*>(word)) < poisonEnd_; ++word) {
+        *word = POISON;
+    }
+}
+
+size_t StackProbe::measure() const {
+    if (!base_) {
+        return 0;
+    }
+
+    auto* tib = reinterpret_cast<NT_TIB*>(NtCurrentTeb());
+    char* limit = static_cast<char*>(tib->StackLimit);
+
+    // Стек вырос за пределы закоммиченной части - точность до страницы
+    if (limit < initialLimit_) {
+        return static_cast<size_t>(base_ - limit);
+    }
+
+    const auto* word = reinterpret_cast<const uint64_t*>(initialLimit_);
+    while (reinterpret_cast<const char*>(word) < poisonEnd_ && *word == POISON) {
+        ++word;
+    }
+    return static_cast<size_t>(base_ - reinterpret_cast<const char*>(word));
+}
+
+} // namespace GreenThreads
@@ -0,0 +1,220 @@
+#include "StallWatchdog.hpp"
+#include "Scheduler.hpp"
+#include <iostream>
+#include <stdexcept>
+
+namespace GreenThreads {
+
+static constexpr size_t MAX_BACKTRACE_FRAMES = 32;
+
+StallWatchdog::StallWatchdog(std::chrono::milliseconds threshold,
+                             std::chrono::milliseconds sampleInterval)
+    : threshold_(threshold),
+      sampleInterval_(sampleInterval),
+      handler_(&StallWatchdog::printReport),
+      stopRequested_(false) {
+    if (threshold_.count() <= 0 || sampleInterval_.count() <= 0) {
+        throw std::invalid_argument("StallWatchdog threshold and interval must be positive");
+    }
+}
+
+StallWatchdog::~StallWatchdog() {
+    stop();
+}
+
+void StallWatchdog::watch(Scheduler& scheduler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_.push_back({&scheduler, scheduler.sampleSlice().dispatchCount,
+                        std::chrono::steady_clock::now(), false});
+}
+
+void StallWatchdog::setReportHandler(ReportHandler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    handler_ = handler ? std::move(handler) : ReportHandler(&StallWatchdog::printReport);
+}
+
+void StallWatchdog::setCaptureBacktrace(bool enabled) {
+    captureBacktrace_.store(enabled, std::memory_order_relaxed);
+}
+
+void StallWatchdog::start() {
+    if (thread_.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = false;
+    }
+    thread_ = std::thread(&StallWatchdog::loop, this);
+}
+
+void StallWatchdog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    stopCv_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void StallWatchdog::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<Report> reports;
+    while (!stopRequested_) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& watched : watched_) {
+            check(watched, now, reports);
+        }
+
+        // Обработчик вызывается без mutex_, чтобы он мог звать watch() и setReportHandler()
+        if (!reports.empty()) {
+            ReportHandler handler = handler_;
+            lock.unlock();
+            for (const auto& report : reports) {
+                try {
+                    handler(report);
+                } catch (const std::exception& e) {
+                    std::cerr << "ERROR in stall report handler: " << e.what() << std::endl;
+                } catch (...) {
+                    std::cerr << "UNKNOWN ERROR in stall report handler" << std::endl;
+                }
+            }
+            reports.clear();
+            lock.lock();
+        }
+
+        stopCv_.wait_for(lock, sampleInterval_, [this] { return stopRequested_; });
+    }
+}
+
+void StallWatchdog::check(Watched& watched, std::chrono::steady_clock::time_point now,
+                          std::vector<Report>& reports) {
+    Scheduler::SliceSample sample = watched.scheduler->sampleSlice();
+
+    // Новый квант начался после прошлой выборки - отсчет заново
+    if (sample.dispatchCount != watched.dispatchCount) {
+        watched.dispatchCount = sample.dispatchCount;
+        watched.sliceSeenAt = now;
+        watched.reported = false;
+        return;
+    }
+
+    if (sample.threadId < 0 || watched.reported) {
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - watched.sliceSeenAt);
+    if (elapsed < threshold_) {
+        return;
+    }
+
+    watched.reported = true;
+
+    Report report{sample.threadId, sample.spawnSite, elapsed, {}};
+    if (captureBacktrace_.load(std::memory_order_relaxed)) {
+        if (!captureBacktrace(*watched.scheduler, sample.dispatchCount, report.backtrace)) {
+            report.backtrace.clear();
+        }
+    }
+
+    reports.push_back(std::move(report));
+}
+
+#if defined(_M_X64)
+// Закоммиченная часть стека, содержащая rsp: от него до базы стека память
+// читается без исключений, ниже - guard-страница или резерв
+static bool committedStackRange(DWORD64 rsp, DWORD64& low, DWORD64& high) {
+    MEMORY_BASIC_INFORMATION info = {};
+    if (!VirtualQuery(reinterpret_cast<LPCVOID>(rsp), &info, sizeof(info))) {
+        return false;
+    }
+    if (info.State != MEM_COMMIT || (info.Protect & (PAGE_GUARD | PAGE_NOACCESS)) ||
+        !(info.Protect & (PAGE_READWRITE | PAGE_READONLY | PAGE_WRITECOPY))) {
+        return false;
+    }
+    low = reinterpret_cast<DWORD64>(info.BaseAddress);
+    high = low + info.RegionSize;
+    return true;
+}
+#endif
+
+bool StallWatchdog::captureBacktrace(Scheduler& scheduler, uint64_t dispatchCount,
+                                     std::vector<void*>& frames) {
+#if defined(_M_X64)
+    DWORD osThreadId = scheduler.getOsThreadId();
+    if (osThreadId == 0 || osThreadId == GetCurrentThreadId()) {
+        return false;
+    }
+
+    HANDLE osThread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+                                 FALSE, osThreadId);
+    if (!osThread) {
+        return false;
+    }
+
+    // Пока поток остановлен, кучу трогать нельзя: он может держать ее блокировку
+    frames.clear();
+    frames.reserve(MAX_BACKTRACE_FRAMES);
+
+    bool captured = false;
+    if (SuspendThread(osThread) != static_cast<DWORD>(-1)) {
+        // Поток мог успеть переключиться, пока мы его останавливали. Ждать
+        // sampleSlice() нельзя: поток мог остановиться посреди публикации кванта
+        Scheduler::SliceSample sample{};
+        CONTEXT context = {};
+        context.ContextFlags = CONTEXT_FULL;
+        DWORD64 stackLow = 0;
+        DWORD64 stackHigh = 0;
+        if (scheduler.trySampleSlice(sample) && sample.dispatchCount == dispatchCount &&
+            GetThreadContext(osThread, &context) &&
+            committedStackRange(context.Rsp, stackLow, stackHigh)) {
+            while (context.Rip && frames.size() < MAX_BACKTRACE_FRAMES) {
+                frames.push_back(reinterpret_cast<void*>(context.Rip));
+
+                // Испорченная раскрутка не должна уронить процесс нарушением доступа
+                if (context.Rsp < stackLow || context.Rsp + sizeof(DWORD64) > stackHigh) {
+                    break;
+                }
+
+                DWORD64 imageBase = 0;
+                PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(context.Rip, &imageBase, nullptr);
+                if (!function) {
+                    // Листовая функция: адрес возврата лежит на вершине стека
+                    context.Rip = *reinterpret_cast<DWORD64*>(context.Rsp);
+                    context.Rsp += sizeof(DWORD64);
+                    continue;
+                }
+
+                void* handlerData = nullptr;
+                DWORD64 establisherFrame = 0;
+                RtlVirtualUnwind(UNW_FLAG_NHANDLER, imageBase, context.Rip, function,
+                                 &context, &handlerData, &establisherFrame, nullptr);
+            }
+            captured = !frames.empty();
+        }
+        ResumeThread(osThread);
+    }
+
+    CloseHandle(osThread);
+    return captured;
+#else
+    (void)scheduler;
+    (void)dispatchCount;
+    (void)frames;
+    return false;
+#endif
+}
+
+void StallWatchdog::printReport(const Report& report) {
+    std::cerr << "STALL: thread " << report.threadId
+              << " (spawned at " << (report.spawnSite ? report.spawnSite : "unknown") << ")"
+              << " has not yielded for " << report.sliceDuration.count() << " ms" << std::endl;
+
+    for (size_t i = 0; i < report.backtrace.size(); ++i) {
+        std::cerr << "    #" << i << " " << report.backtrace[i] << std::endl;
+    }
+}
+
+} // namespace GreenThreads
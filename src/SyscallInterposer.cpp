@@ -0,0 +1,522 @@
+#include <winsock2.h>
+#include <windows.h>
+#include <tlhelp32.h>
+#include "SyscallInterposer.hpp"
+#include "GreenThread.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace GreenThreads {
+
+namespace {
+
+using RecvFn = int (WSAAPI*)(SOCKET, char*, int, int);
+using SendFn = int (WSAAPI*)(SOCKET, const char*, int, int);
+using ConnectFn = int (WSAAPI*)(SOCKET, const sockaddr*, int);
+using SelectFn = int (WSAAPI*)(int, fd_set*, fd_set*, fd_set*, const timeval*);
+using PollFn = int (WSAAPI*)(LPWSAPOLLFD, ULONG, int);
+using IoctlFn = int (WSAAPI*)(SOCKET, long, u_long*);
+using CloseFn = int (WSAAPI*)(SOCKET);
+using SocketFn = SOCKET (WSAAPI*)(int, int, int);
+using SocketAFn = SOCKET (WSAAPI*)(int, int, int, LPWSAPROTOCOL_INFOA, GROUP, DWORD);
+using SocketWFn = SOCKET (WSAAPI*)(int, int, int, LPWSAPROTOCOL_INFOW, GROUP, DWORD);
+using AcceptFn = SOCKET (WSAAPI*)(SOCKET, sockaddr*, int*);
+using WsaIoctlFn = int (WSAAPI*)(SOCKET, DWORD, LPVOID, DWORD, LPVOID, DWORD, LPDWORD, LPWSAOVERLAPPED,
+                                 LPWSAOVERLAPPED_COMPLETION_ROUTINE);
+using EventSelectFn = int (WSAAPI*)(SOCKET, WSAEVENT, long);
+using AsyncSelectFn = int (WSAAPI*)(SOCKET, HWND, u_int, long);
+using SleepFn = void (WINAPI*)(DWORD);
+
+RecvFn realRecv = nullptr;
+SendFn realSend = nullptr;
+ConnectFn realConnect = nullptr;
+SelectFn realSelect = nullptr;
+PollFn realPoll = nullptr;
+IoctlFn realIoctl = nullptr;
+CloseFn realClose = nullptr;
+SocketFn realSocket = nullptr;
+SocketAFn realSocketA = nullptr;
+SocketWFn realSocketW = nullptr;
+AcceptFn realAccept = nullptr;
+WsaIoctlFn realWsaIoctl = nullptr;
+EventSelectFn realEventSelect = nullptr;
+AsyncSelectFn realAsyncSelect = nullptr;
+SleepFn realSleep = nullptr;
+
+struct PatchedSlot {
+    ULONG_PTR* slot;
+    ULONG_PTR original;
+};
+
+std::mutex installMutex;
+std::vector<PatchedSlot> patchedSlots;
+bool installed = false;
+
+// Сокеты, про которые точно известно, что они блокирующие: созданы или
+// приняты через перехваченные вызовы и не переводились в неблокирующий режим
+// (ioctlsocket, WSAIoctl, WSAEventSelect, WSAAsyncSelect). Кооперативным
+// делаем только их, остальные - созданные до install() или в неперехваченных
+// модулях - идут к оригинальным функциям. Хуки вызываются из любых потоков
+// ОС, в том числе не связанных с планировщиком, поэтому здесь настоящий
+// мьютекс при любой политике
+std::mutex blockingMutex;
+std::unordered_set<SOCKET> blockingSockets;
+
+bool isKnownBlocking(SOCKET s) {
+    std::lock_guard<std::mutex> lock(blockingMutex);
+    return blockingSockets.count(s) != 0;
+}
+
+void setKnownBlocking(SOCKET s, bool blocking) {
+    std::lock_guard<std::mutex> lock(blockingMutex);
+    if (blocking) {
+        blockingSockets.insert(s);
+    } else {
+        blockingSockets.erase(s);
+    }
+}
+
+// Зеленый поток, на волокне которого мы сейчас выполняемся
+std::shared_ptr<GreenThread> cooperativeThread() {
+    auto thread = GreenThread::current();
+    if (!thread || GetCurrentFiber() != thread->getFiber()) {
+        return nullptr;
+    }
+    return thread;
+}
+
+// false - поток отменен, ожидание нужно прервать. Без дедлайна поток
+// опрашивает готовность сокета и диспетчеризуется на каждом круге
+bool yieldOnce(GreenThread& thread, GreenThread::TimePoint deadline = GreenThread::TimePoint::min()) {
+    if (thread.isCancelled()) {
+        return false;
+    }
+    thread.yieldWaiting(deadline);
+    return !thread.isCancelled();
+}
+
+// Ошибки WSAPoll не обрабатываем: оригинальный вызов сообщит их сам
+bool waitSocket(GreenThread& thread, SOCKET s, short events) {
+    WSAPOLLFD fd = {};
+    fd.fd = s;
+    fd.events = events;
+    while (realPoll(&fd, 1, 0) == 0) {
+        if (!yieldOnce(thread)) {
+            WSASetLastError(WSAEINTR);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Итог неблокирующего connect: 0 или код ошибки. WSAPoll до Windows 10 2004
+// не сообщает о неудачном connect, поэтому ждем через select с exceptfds
+int waitConnect(GreenThread& thread, SOCKET s) {
+    const timeval zero = {0, 0};
+    for (;;) {
+        fd_set writable;
+        fd_set failed;
+        FD_ZERO(&writable);
+        FD_ZERO(&failed);
+        FD_SET(s, &writable);
+        FD_SET(s, &failed);
+
+        int result = realSelect(0, nullptr, &writable, &failed, &zero);
+        if (result == SOCKET_ERROR) {
+            return WSAGetLastError();
+        }
+        if (result > 0) {
+            int error = 0;
+            int length = sizeof(error);
+            if (getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) == SOCKET_ERROR) {
+                return WSAGetLastError();
+            }
+            if (!error && FD_ISSET(s, &failed)) {
+                error = WSAECONNREFUSED;
+            }
+            return error;
+        }
+        if (!yieldOnce(thread)) {
+            return WSAEINTR;
+        }
+    }
+}
+
+bool deadlinePassed(bool infinite, std::chrono::steady_clock::time_point deadline) {
+    return !infinite && std::chrono::steady_clock::now() >= deadline;
+}
+
+int WSAAPI hookRecv(SOCKET s, char* buf, int len, int flags) {
+    auto thread = cooperativeThread();
+    if (thread && isKnownBlocking(s) && !waitSocket(*thread, s, POLLRDNORM)) {
+        return SOCKET_ERROR;
+    }
+    return realRecv(s, buf, len, flags);
+}
+
+int WSAAPI hookSend(SOCKET s, const char* buf, int len, int flags) {
+    auto thread = cooperativeThread();
+    if (thread && isKnownBlocking(s) && !waitSocket(*thread, s, POLLWRNORM)) {
+        return SOCKET_ERROR;
+    }
+    return realSend(s, buf, len, flags);
+}
+
+int WSAAPI hookConnect(SOCKET s, const sockaddr* name, int nameLength) {
+    auto thread = cooperativeThread();
+    if (!thread || !isKnownBlocking(s)) {
+        return realConnect(s, name, nameLength);
+    }
+
+    u_long mode = 1;
+    if (realIoctl(s, FIONBIO, &mode) == SOCKET_ERROR) {
+        return realConnect(s, name, nameLength);
+    }
+
+    int result = realConnect(s, name, nameLength);
+    int error = result == SOCKET_ERROR ? WSAGetLastError() : 0;
+
+    if (result == SOCKET_ERROR && error == WSAEWOULDBLOCK) {
+        error = waitConnect(*thread, s);
+        result = error ? SOCKET_ERROR : 0;
+    }
+
+    // Сокет был блокирующим, и мы это видели сами - возвращаем режим
+    mode = 0;
+    realIoctl(s, FIONBIO, &mode);
+    if (result == SOCKET_ERROR) {
+        WSASetLastError(error);
+    }
+    return result;
+}
+
+int WSAAPI hookPoll(LPWSAPOLLFD fds, ULONG count, int timeout) {
+    auto thread = cooperativeThread();
+    if (!thread || timeout == 0) {
+        return realPoll(fds, count, timeout);
+    }
+
+    bool infinite = timeout < 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(infinite ? 0 : timeout);
+    for (;;) {
+        int result = realPoll(fds, count, 0);
+        if (result != 0 || deadlinePassed(infinite, deadline)) {
+            return result;
+        }
+        if (!yieldOnce(*thread)) {
+            WSASetLastError(WSAEINTR);
+            return SOCKET_ERROR;
+        }
+    }
+}
+
+int WSAAPI hookSelect(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, const timeval* timeout) {
+    auto thread = cooperativeThread();
+    if (!thread || (timeout && timeout->tv_sec == 0 && timeout->tv_usec == 0)) {
+        return realSelect(nfds, readfds, writefds, exceptfds, timeout);
+    }
+
+    bool infinite = timeout == nullptr;
+    auto deadline = std::chrono::steady_clock::now();
+    if (!infinite) {
+        deadline += std::chrono::seconds(timeout->tv_sec) + std::chrono::microseconds(timeout->tv_usec);
+    }
+
+    // select портит переданные множества, поэтому опрашиваем копии
+    fd_set sets[3];
+    fd_set* targets[3] = {readfds, writefds, exceptfds};
+    const timeval zero = {0, 0};
+    for (;;) {
+        for (int i = 0; i < 3; ++i) {
+            if (targets[i]) {
+                sets[i] = *targets[i];
+            }
+        }
+
+        int result = realSelect(nfds, readfds ? &sets[0] : nullptr, writefds ? &sets[1] : nullptr,
+                                exceptfds ? &sets[2] : nullptr, &zero);
+        if (result != 0 || deadlinePassed(infinite, deadline)) {
+            for (int i = 0; i < 3; ++i) {
+                if (targets[i]) {
+                    *targets[i] = sets[i];
+                }
+            }
+            return result;
+        }
+        if (!yieldOnce(*thread)) {
+            WSASetLastError(WSAEINTR);
+            return SOCKET_ERROR;
+        }
+    }
+}
+
+// Новые сокеты Winsock всегда создаются блокирующими
+SOCKET WSAAPI hookSocket(int af, int type, int protocol) {
+    SOCKET s = realSocket(af, type, protocol);
+    if (s != INVALID_SOCKET) {
+        setKnownBlocking(s, true);
+    }
+    return s;
+}
+
+SOCKET WSAAPI hookSocketA(int af, int type, int protocol, LPWSAPROTOCOL_INFOA info, GROUP group, DWORD flags) {
+    SOCKET s = realSocketA(af, type, protocol, info, group, flags);
+    if (s != INVALID_SOCKET) {
+        setKnownBlocking(s, true);
+    }
+    return s;
+}
+
+SOCKET WSAAPI hookSocketW(int af, int type, int protocol, LPWSAPROTOCOL_INFOW info, GROUP group, DWORD flags) {
+    SOCKET s = realSocketW(af, type, protocol, info, group, flags);
+    if (s != INVALID_SOCKET) {
+        setKnownBlocking(s, true);
+    }
+    return s;
+}
+
+// Принятый сокет наследует режим слушающего
+SOCKET WSAAPI hookAccept(SOCKET s, sockaddr* address, int* addressLength) {
+    bool blocking = isKnownBlocking(s);
+    auto thread = cooperativeThread();
+    if (thread && blocking && !waitSocket(*thread, s, POLLRDNORM)) {
+        return INVALID_SOCKET;
+    }
+    SOCKET accepted = realAccept(s, address, addressLength);
+    if (accepted != INVALID_SOCKET && blocking) {
+        setKnownBlocking(accepted, true);
+    }
+    return accepted;
+}
+
+int WSAAPI hookIoctl(SOCKET s, long command, u_long* argument) {
+    int result = realIoctl(s, command, argument);
+    if (result != SOCKET_ERROR && command == static_cast<long>(FIONBIO) && argument) {
+        setKnownBlocking(s, *argument == 0);
+    }
+    return result;
+}
+
+int WSAAPI hookWsaIoctl(SOCKET s, DWORD code, LPVOID input, DWORD inputLength, LPVOID output, DWORD outputLength,
+                        LPDWORD bytesReturned, LPWSAOVERLAPPED overlapped,
+                        LPWSAOVERLAPPED_COMPLETION_ROUTINE completion) {
+    int result = realWsaIoctl(s, code, input, inputLength, output, outputLength, bytesReturned, overlapped, completion);
+    if (result != SOCKET_ERROR && code == static_cast<DWORD>(FIONBIO) && input && inputLength >= sizeof(u_long)) {
+        setKnownBlocking(s, *static_cast<u_long*>(input) == 0);
+    }
+    return result;
+}
+
+// WSAEventSelect и WSAAsyncSelect переводят сокет в неблокирующий режим
+int WSAAPI hookEventSelect(SOCKET s, WSAEVENT event, long networkEvents) {
+    int result = realEventSelect(s, event, networkEvents);
+    if (result != SOCKET_ERROR) {
+        setKnownBlocking(s, false);
+    }
+    return result;
+}
+
+int WSAAPI hookAsyncSelect(SOCKET s, HWND window, u_int message, long networkEvents) {
+    int result = realAsyncSelect(s, window, message, networkEvents);
+    if (result != SOCKET_ERROR) {
+        setKnownBlocking(s, false);
+    }
+    return result;
+}
+
+int WSAAPI hookClose(SOCKET s) {
+    setKnownBlocking(s, false);
+    return realClose(s);
+}
+
+void WINAPI hookSleep(DWORD milliseconds) {
+    auto thread = cooperativeThread();
+    if (!thread) {
+        realSleep(milliseconds);
+        return;
+    }
+
+    bool infinite = milliseconds == INFINITE;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(infinite ? 0 : milliseconds);
+    do {
+        if (!yieldOnce(*thread, infinite ? GreenThread::TimePoint::max() : deadline)) {
+            return;
+        }
+    } while (!deadlinePassed(infinite, deadline));
+}
+
+struct Hook {
+    ULONG_PTR original;
+    ULONG_PTR replacement;
+};
+
+template<typename Fn>
+void resolve(std::vector<Hook>& hooks, HMODULE module, const char* name, Fn& real, Fn replacement) {
+    if (!module) {
+        return;
+    }
+    auto address = reinterpret_cast<Fn>(GetProcAddress(module, name));
+    if (!address) {
+        return;
+    }
+    if (!real) {
+        real = address;
+    }
+    hooks.push_back({reinterpret_cast<ULONG_PTR>(address), reinterpret_cast<ULONG_PTR>(replacement)});
+}
+
+void writeSlot(ULONG_PTR* slot, ULONG_PTR value) {
+    DWORD oldProtection = 0;
+    if (!VirtualProtect(slot, sizeof(*slot), PAGE_READWRITE, &oldProtection)) {
+        std::cerr << "ERROR: SyscallInterposer failed to unprotect import slot " << slot << std::endl;
+        return;
+    }
+    *slot = value;
+    VirtualProtect(slot, sizeof(*slot), oldProtection, &oldProtection);
+}
+
+void patchModule(HMODULE module, const std::vector<Hook>& hooks) {
+    auto* base = reinterpret_cast<BYTE*>(module);
+    auto* dos = reinterpret_cast<IMAGE_DOS_HEADER*>(base);
+    if (dos->e_magic != IMAGE_DOS_SIGNATURE) {
+        return;
+    }
+    auto* nt = reinterpret_cast<IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+    if (nt->Signature != IMAGE_NT_SIGNATURE) {
+        return;
+    }
+
+    const IMAGE_DATA_DIRECTORY& imports = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+    if (!imports.VirtualAddress) {
+        return;
+    }
+
+    for (auto* descriptor = reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR*>(base + imports.VirtualAddress);
+         descriptor->Name; ++descriptor) {
+        for (auto* thunk = reinterpret_cast<IMAGE_THUNK_DATA*>(base + descriptor->FirstThunk);
+             thunk->u1.Function; ++thunk) {
+            for (const auto& hook : hooks) {
+                if (thunk->u1.Function == hook.original) {
+                    patchedSlots.push_back({&thunk->u1.Function, hook.original});
+                    writeSlot(&thunk->u1.Function, hook.replacement);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool resolveHooks(std::vector<Hook>& hooks) {
+    HMODULE winsock = GetModuleHandleA("ws2_32.dll");
+    resolve(hooks, winsock, "recv", realRecv, &hookRecv);
+    resolve(hooks, winsock, "send", realSend, &hookSend);
+    resolve(hooks, winsock, "connect", realConnect, &hookConnect);
+    resolve(hooks, winsock, "select", realSelect, &hookSelect);
+    resolve(hooks, winsock, "WSAPoll", realPoll, &hookPoll);
+    resolve(hooks, winsock, "ioctlsocket", realIoctl, &hookIoctl);
+    resolve(hooks, winsock, "closesocket", realClose, &hookClose);
+    resolve(hooks, winsock, "socket", realSocket, &hookSocket);
+    resolve(hooks, winsock, "WSASocketA", realSocketA, &hookSocketA);
+    resolve(hooks, winsock, "WSASocketW", realSocketW, &hookSocketW);
+    resolve(hooks, winsock, "accept", realAccept, &hookAccept);
+    resolve(hooks, winsock, "WSAIoctl", realWsaIoctl, &hookWsaIoctl);
+    resolve(hooks, winsock, "WSAEventSelect", realEventSelect, &hookEventSelect);
+    resolve(hooks, winsock, "WSAAsyncSelect", realAsyncSelect, &hookAsyncSelect);
+
+    // Sleep импортируется и из kernel32, и через api-set из kernelbase
+    resolve(hooks, GetModuleHandleA("kernelbase.dll"), "Sleep", realSleep, &hookSleep);
+    resolve(hooks, GetModuleHandleA("kernel32.dll"), "Sleep", realSleep, &hookSleep);
+    return !hooks.empty();
+}
+
+// Пустая строка - каталог не определен (GetSystemWow64Directory на 32-битной Windows)
+std::wstring systemDirectory(UINT (WINAPI* query)(LPWSTR, UINT)) {
+    wchar_t path[MAX_PATH] = {};
+    UINT length = query(path, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return {};
+    }
+    return std::wstring(path, length);
+}
+
+bool isUnder(const wchar_t* path, const std::wstring& directory) {
+    return !directory.empty() &&
+           _wcsnicmp(path, directory.c_str(), directory.size()) == 0 &&
+           path[directory.size()] == L'\\';
+}
+
+} // namespace
+
+bool SyscallInterposer::install() {
+    std::lock_guard<std::mutex> lock(installMutex);
+
+    std::vector<Hook> hooks;
+    if (!resolveHooks(hooks)) {
+        return false;
+    }
+
+    // Системные DLL (ws2_32, mswsock, kernelbase...) вызывают Winsock и Sleep
+    // для собственной работы, а сама библиотека - из планировщика. Их не трогаем
+    HMODULE self = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                       reinterpret_cast<LPCWSTR>(&hookRecv), &self);
+    std::wstring system = systemDirectory(&GetSystemDirectoryW);
+    std::wstring wow64 = systemDirectory(&GetSystemWow64DirectoryW);
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        std::cerr << "ERROR: SyscallInterposer failed to enumerate modules, error: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    MODULEENTRY32W entry = {};
+    entry.dwSize = sizeof(entry);
+    for (BOOL found = Module32FirstW(snapshot, &entry); found; found = Module32NextW(snapshot, &entry)) {
+        if (entry.hModule == self || isUnder(entry.szExePath, system) || isUnder(entry.szExePath, wow64)) {
+            continue;
+        }
+        patchModule(entry.hModule, hooks);
+    }
+    CloseHandle(snapshot);
+
+    installed = true;
+    return true;
+}
+
+bool SyscallInterposer::install(const std::vector<HMODULE>& modules) {
+    std::lock_guard<std::mutex> lock(installMutex);
+
+    std::vector<Hook> hooks;
+    if (!resolveHooks(hooks)) {
+        return false;
+    }
+    for (HMODULE module : modules) {
+        if (module) {
+            patchModule(module, hooks);
+        }
+    }
+
+    installed = true;
+    return true;
+}
+
+void SyscallInterposer::uninstall() {
+    std::lock_guard<std::mutex> lock(installMutex);
+    for (auto it = patchedSlots.rbegin(); it != patchedSlots.rend(); ++it) {
+        writeSlot(it->slot, it->original);
+    }
+    patchedSlots.clear();
+    installed = false;
+}
+
+bool SyscallInterposer::isInstalled() {
+    std::lock_guard<std::mutex> lock(installMutex);
+    return installed;
+}
+
+} // namespace GreenThreads
@@ -0,0 +1,93 @@
+#include "TaskGroup.hpp"
+#include "Scheduler.hpp"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace GreenThreads {
+
+static CancellationToken currentToken() {
+    auto current = Scheduler::instance().getCurrentThread();
+    return current ? current->getCancellationToken() : CancellationToken();
+}
+
+TaskGroup::TaskGroup() : TaskGroup(currentToken()) {}
+
+TaskGroup::TaskGroup(const CancellationToken& parent)
+    : token_(CancellationToken::create(parent)) {}
+
+TaskGroup::~TaskGroup() {
+    if (removeFinished()) {
+        return;
+    }
+
+    // Выход из области видимости без явного wait() отменяет оставшуюся работу
+    token_.cancel();
+
+    if (!Scheduler::instance().getCurrentThread()) {
+        // Деструктор не может бросать, а вернуться раньше детей нельзя:
+        // они держат ссылки на состояние вызывающего кода
+        try {
+            driveUntilFinished();
+        } catch (const std::exception& e) {
+            std::cerr << "FATAL: TaskGroup destroyed outside of green thread with "
+                      << children_.size() << " unfinished children: " << e.what() << std::endl;
+            std::terminate();
+        }
+        return;
+    }
+
+    wait();
+}
+
+std::shared_ptr<GreenThread> TaskGroup::spawn(GreenThread::ThreadFunction func, const char* spawnSite) {
+    auto child = std::make_shared<GreenThread>(std::move(func), spawnSite);
+    child->setCancellationToken(token_);
+    // Отказ в допуске не должен оставлять в группе поток, который никогда не завершится
+    child->start();
+    children_.push_back(child);
+    return child;
+}
+
+void TaskGroup::cancel() {
+    token_.cancel();
+}
+
+void TaskGroup::wait() {
+    auto current = Scheduler::instance().getCurrentThread();
+    if (!current) {
+        driveUntilFinished();
+        return;
+    }
+
+    // Отмененные дети просыпаются на своей следующей диспетчеризации
+    while (!removeFinished()) {
+        current->yieldWaiting();
+    }
+}
+
+void TaskGroup::driveUntilFinished() {
+    // Вне зеленого потока ждать некому - крутим планировщик пошагово сами.
+    // Если его цикл уже запущен, runOnce() бросает исключение
+    Scheduler& scheduler = Scheduler::instance();
+    while (!removeFinished()) {
+        auto timeout = scheduler.runOnce(0);
+        if (timeout.count() > 0 && !removeFinished()) {
+            DWORD waitMs = timeout == std::chrono::milliseconds::max()
+                ? INFINITE
+                : static_cast<DWORD>(timeout.count());
+            WaitForSingleObject(scheduler.getReadyEvent(), waitMs);
+        }
+    }
+}
+
+bool TaskGroup::removeFinished() {
+    children_.erase(std::remove_if(children_.begin(), children_.end(),
+                                   [](const std::shared_ptr<GreenThread>& child) {
+                                       return child->isFinished();
+                                   }),
+                    children_.end());
+    return children_.empty();
+}
+
+} // namespace GreenThreads
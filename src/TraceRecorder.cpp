@@ -0,0 +1,208 @@
+#include "TraceRecorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace GreenThreads {
+
+std::atomic<bool> TraceRecorder::enabled_{false};
+
+namespace {
+
+// Один писатель (владеющий системный поток) и один читатель (writeChromeTrace)
+struct Ring {
+    explicit Ring(size_t capacity, int workerId)
+        : events(new TraceRecorder::Event[capacity]),
+          mask(capacity - 1),
+          worker(workerId) {}
+
+    std::unique_ptr<TraceRecorder::Event[]> events;
+    size_t mask;
+    int worker;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    size_t capacity = 1 << 16;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+thread_local Ring* localRing = nullptr;
+
+Ring* registerRing() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.rings.push_back(std::make_unique<Ring>(reg.capacity, static_cast<int>(reg.rings.size())));
+    return reg.rings.back().get();
+}
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void writeTimestamp(std::ostream& out, uint64_t nanoseconds) {
+    char fill = out.fill('0');
+    out << nanoseconds / 1000 << '.' << std::setw(3) << nanoseconds % 1000;
+    out.fill(fill);
+}
+
+void writeEventHeader(std::ostream& out, bool& first, const char* phase, int worker, uint64_t timestamp) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "{\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << worker << ",\"ts\":";
+    writeTimestamp(out, timestamp);
+}
+
+struct Drained {
+    TraceRecorder::Event event;
+    int worker;
+};
+
+} // namespace
+
+void TraceRecorder::enable(size_t ringCapacity) {
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.capacity = roundUpToPowerOfTwo(std::max<size_t>(ringCapacity, 2));
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void TraceRecorder::disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void TraceRecorder::append(EventType type, int threadId, int otherId) {
+    Ring* ring = localRing;
+    if (!ring) {
+        ring = localRing = registerRing();
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) > ring->mask) {
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = ring->events[head & ring->mask];
+    event.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    event.threadId = threadId;
+    event.otherId = otherId;
+    event.type = type;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t TraceRecorder::droppedEvents() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint64_t total = 0;
+    for (const auto& ring : reg.rings) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream& out) {
+    std::vector<Drained> drained;
+    std::vector<int> workers;
+
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const auto& ring : reg.rings) {
+            workers.push_back(ring->worker);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                drained.push_back({ring->events[tail & ring->mask], ring->worker});
+            }
+            ring->tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    std::stable_sort(drained.begin(), drained.end(), [](const Drained& a, const Drained& b) {
+        return a.event.timestamp < b.event.timestamp;
+    });
+
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    for (int worker : workers) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << worker
+            << ",\"args\":{\"name\":\"worker " << worker << "\"}}";
+    }
+
+    // Стрелка от пробуждающего к пробуждаемому замыкается на его следующем Dispatch
+    std::unordered_map<int, uint64_t> pendingFlows;
+    uint64_t nextFlowId = 1;
+
+    for (const auto& item : drained) {
+        const Event& event = item.event;
+        switch (event.type) {
+        case EventType::Dispatch: {
+            writeEventHeader(out, first, "B", item.worker, event.timestamp);
+            out << ",\"name\":\"green thread " << event.threadId << "\"}";
+
+            auto flow = pendingFlows.find(event.threadId);
+            if (flow != pendingFlows.end()) {
+                writeEventHeader(out, first, "f", item.worker, event.timestamp);
+                out << ",\"name\":\"wake\",\"cat\":\"wake\",\"bp\":\"e\",\"id\":" << flow->second << "}";
+                pendingFlows.erase(flow);
+            }
+            break;
+        }
+        case EventType::Yield:
+        case EventType::Finish:
+            writeEventHeader(out, first, "E", item.worker, event.timestamp);
+            out << ",\"args\":{\"reason\":\""
+                << (event.type == EventType::Yield ? "yield" : "finish") << "\"}}";
+            break;
+        case EventType::BlockMutex:
+        case EventType::BlockCondition:
+            writeEventHeader(out, first, "i", item.worker, event.timestamp);
+            out << ",\"s\":\"t\",\"name\":\""
+                << (event.type == EventType::BlockMutex ? "block on Mutex" : "block on ConditionVariable")
+                << "\",\"args\":{\"thread\":" << event.threadId << "}}";
+            break;
+        case EventType::Wake: {
+            uint64_t flowId = nextFlowId++;
+            pendingFlows[event.otherId] = flowId;
+            writeEventHeader(out, first, "i", item.worker, event.timestamp);
+            out << ",\"s\":\"t\",\"name\":\"wake\",\"args\":{\"waker\":" << event.threadId
+                << ",\"wakee\":" << event.otherId << "}}";
+            writeEventHeader(out, first, "s", item.worker, event.timestamp);
+            out << ",\"name\":\"wake\",\"cat\":\"wake\",\"id\":" << flowId << "}";
+            break;
+        }
+        case EventType::Spawn:
+            writeEventHeader(out, first, "i", item.worker, event.timestamp);
+            out << ",\"s\":\"t\",\"name\":\"spawn\",\"args\":{\"thread\":" << event.threadId
+                << ",\"parent\":" << event.otherId << "}}";
+            break;
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+} // namespace GreenThreads